@@ -1,10 +1,158 @@
 #include <Arduino.h>
 
-#define MAX_EXPRESSION_LENGTH 15
-#define MAX_DICTIONARY_CUSTOM_LENGTH 20
-#define MAX_DICTIONARY_TOTAL_LENGTH MAX_DICTIONARY_CUSTOM_LENGTH + 256
-#define MAX_BINARY_PATH 128
 #define defaultKey "3274727565\n3266616c7365\n1e2c5c6e"
+
+/* ALFABETOS DE SÍMBOLOS
+Cada alfabeto informa quais símbolos individuais (folhas de 1 byte) entram na árvore, além das expressões da chave.
+SIZE   : quantidade de símbolos
+symbol : retorna o símbolo de determinada posição (0 a SIZE-1)
+index  : retorna a posição do símbolo no alfabeto, ou -1 se o símbolo não pertence ao alfabeto
+Alfabetos menores geram tabelas menores e códigos mais curtos, mas só codificam textos compostos pelos seus símbolos.
+*/
+struct CowcAlphabetFull // todos os 256 valores de byte (de 00000000 a 11111111)
+{
+   static const int SIZE = 256;
+   static byte symbol(int i) { return ((byte)i); }
+   static int index(byte c) { return (c); }
+};
+
+struct CowcAlphabetPrintable // ASCII imprimível (' ' a '~'), mais TAB, LF e CR
+{
+   static const int SIZE = 3 + ('~' - ' ' + 1);
+   static byte symbol(int i)
+   {
+      if (i < 3)
+         return ((byte)"\t\n\r"[i]);
+      return ((byte)(' ' + i - 3));
+   }
+   static int index(byte c)
+   {
+      if (c >= ' ' && c <= '~')
+         return (3 + c - ' ');
+      if (c == '\t')
+         return (0);
+      if (c == '\n')
+         return (1);
+      if (c == '\r')
+         return (2);
+      return (-1);
+   }
+};
+
+struct CowcAlphabetHex // dígitos hexadecimais, em caixa baixa e caixa alta
+{
+   static const int SIZE = 10 + 6 + 6;
+   static byte symbol(int i)
+   {
+      if (i < 10)
+         return ((byte)('0' + i));
+      if (i < 16)
+         return ((byte)('a' + i - 10));
+      return ((byte)('A' + i - 16));
+   }
+   static int index(byte c)
+   {
+      if (c >= '0' && c <= '9')
+         return (c - '0');
+      if (c >= 'a' && c <= 'f')
+         return (10 + c - 'a');
+      if (c >= 'A' && c <= 'F')
+         return (16 + c - 'A');
+      return (-1);
+   }
+};
+
+#define COWC_UNROLL_LIMIT 16 // tamanho máximo de expressão para o qual a comparação é expandida (unroll)
+
+/* comparação de expressões com tamanho máximo conhecido em tempo de compilação.
+   Até COWC_UNROLL_LIMIT bytes o compilador expande a recursão em comparações diretas, sem chamada a memcmp.
+   Acima disso usa memcmp, para não aumentar o código gerado. */
+template <int N, bool UNROLL = (N <= COWC_UNROLL_LIMIT)>
+struct CowcMatch
+{
+   static bool equal(const byte *a, const byte *b, int size)
+   {
+      return (memcmp(a, b, size) == 0);
+   }
+};
+
+template <int N>
+struct CowcMatch<N, true>
+{
+   static bool equal(const byte *a, const byte *b, int size)
+   {
+      if (size <= 0)
+         return (true);
+      if (*a != *b)
+         return (false);
+      return (CowcMatch<N - 1>::equal(a + 1, b + 1, size - 1));
+   }
+};
+
+template <>
+struct CowcMatch<0, true>
+{
+   static bool equal(const byte *, const byte *, int) { return (true); }
+};
+
+/* CONTADORES DE USO
+Um contador por posição da tabela de códigos, incrementado a cada símbolo ou expressão codificada no PACK.
+Quando um contador satura, todos são divididos por 2 (decaimento), mantendo as proporções e dando mais peso ao tráfego recente.
+Os contadores ficam vinculados à tabela de códigos (instância e chave) em que foram medidos, e são zerados ao serem usados com outra.
+*/
+template <int SIZE>
+class CowcStatistics
+{
+private:
+   uint16_t counters[SIZE];
+   uint16_t messageCount = 0;
+   const void *boundTable = NULL;     // instância COWC a que os contadores se referem
+   unsigned long boundGeneration = 0; // chave (geração) dessa instância a que os contadores se referem
+
+public:
+   CowcStatistics()
+   {
+      reset();
+   }
+
+   void reset() // zera contadores
+   {
+      for (int i = 0; i < SIZE; i++)
+         counters[i] = 0;
+      messageCount = 0;
+   }
+
+   void bind(const void *table, unsigned long generation) // vincula contadores a uma tabela de códigos, zerando-os se vinham de outra tabela ou chave
+   {
+      if (table == boundTable && generation == boundGeneration)
+         return;
+      reset();
+      boundTable = table;
+      boundGeneration = generation;
+   }
+
+   void count(int occ) // registra uso da posição occ da tabela de códigos
+   {
+      if (++counters[occ] == 0xffff)
+         decay();
+   }
+
+   void message() // registra uma mensagem comprimida
+   {
+      if (++messageCount == 0xffff)
+         decay();
+   }
+
+   void decay() // divide todos os contadores por 2
+   {
+      for (int i = 0; i < SIZE; i++)
+         counters[i] >>= 1;
+      messageCount >>= 1;
+   }
+
+   uint16_t counter(int occ) { return (counters[occ]); }
+   uint16_t messages() { return (messageCount); }
+};
 /*
 OBS:
 O objetivo é realizar o PACK e o UNPACK de uma string de dados em formato HEXADECIMAL criptografado em com tamanho variável.
@@ -18,7 +166,7 @@ As informações geradas pelo PACK sempre serão um número par de caracteres he
 Primeiro nibble (4 bits) é valor que informa quantos bits, no final da string de dados comprimidos, deverão ser ignorados. É um valor de 0 a 7.
 O último nibble (4 bits) é um OU EXCLUSIVO de todos os demais nibbles do pacote, e serve para agregar um check com possibilidade de detectar alterações ou falhas.
 
-A chave é uma string (também expressa dados em hexadecimal) com até MAX_DICTIONARY_CUSTOM_LENGTH expressões.
+A chave é uma string (também expressa dados em hexadecimal) com até DICTIONARY_CUSTOM_LENGTH expressões.
 Cada expressão é, em hexadecimal, dado por um byte para o peso (2 dígitos hexadecimais), seguido da expressão em hexadecimal
 Para que haja maior compressão dos dados, sugere-se que os identificadores ou expressões mais recorrentes nos dados trasmitidos sejam considerados na chave. 
 
@@ -43,10 +191,25 @@ arquivo chave fica com as seguintes 6 linhas, cada linha separa por um new-line
 3266616c7365
 1e2c5c6e
 
+Linhas de peso largo, iniciadas por '=' (peso com 2 bytes, 4 dígitos hexadecimais):
+   =wwww + expressão (=03e874727565)   expressão com peso de 0 a 65535
+   =wwww (ex.: =0001)                  peso de todos os símbolos do alfabeto não listados na chave. Sem esta linha, vale o peso pré-definido (weigthChar).
+   =wwww + 1 byte do alfabeto (=00c841) peso do símbolo 'A'. Não ocupa posição de expressão, apenas substitui o peso do símbolo.
+Linhas sem '=' mantêm o formato original (peso de 1 byte seguido da expressão), inclusive as de 1 byte ou sem expressão.
+As linhas com '=' permitem que a chave gerada por statisticsKey() reflita o tráfego real (ver ESTATÍSTICAS DE USO).
+
 
 USO DA CLASSE:
 
-Cowc cowc;
+Cowc<> cowc;                                  // limites padrão: expressões de 15 bytes, 20 expressões na chave, códigos de até 128 bits, 256 símbolos
+Cowc<32, 40> cowcGrande;                      // expressões de até 32 bytes e até 40 expressões na chave
+Cowc<8, 10, 32, CowcAlphabetHex> cowcHex;     // dados compostos só por dígitos hexadecimais: tabelas menores e códigos mais curtos
+
+parâmetros do template:
+   EXPRESSION_LENGTH        tamanho máximo (bytes) de uma expressão da chave. Até 255.
+   DICTIONARY_CUSTOM_LENGTH quantidade máxima de expressões na chave
+   BINARY_PATH              tamanho máximo (bits) de um código binário. Até 255.
+   ALPHABET                 alfabeto de símbolos individuais (CowcAlphabetFull, CowcAlphabetPrintable, CowcAlphabetHex ou outro com a mesma interface)
 
 métodos
 
@@ -55,6 +218,19 @@ String cowc.packHex(String asciiText);                     // comprime e criptog
 String cowc.unpackHex(String hexPack);                     // descomprime e retorna dados no formato ASCII original
 
 
+ESTATÍSTICAS DE USO (opcional):
+
+Cowc<>::Statistics stats;                                  // contadores de uso de cada símbolo/expressão (2 bytes por posição da tabela de códigos)
+cowc.collect(&stats);                                      // passa a contar os símbolos e expressões usados no PACK. cowc.collect(NULL) pausa a contagem.
+stats.reset();                                             // zera contadores, para recomeçar a medição
+String cowc.statisticsKey();                               // gera nova chave com os pesos medidos, para uso em key() na origem e no destino
+float cowc.statisticsSavedBits();                          // estimativa de bits economizados por mensagem se a chave de statisticsKey() for usada
+
+Os contadores decaem (são divididos por 2) quando algum deles satura, privilegiando o tráfego mais recente.
+Os contadores são zerados quando a chave muda (key()), mesmo que a coleta esteja pausada: ao reativar com collect(), contadores de
+outra chave ou de outra instância são descartados, pois as posições da tabela de códigos não correspondem mais.
+
+
 
 Sequencia da geração dos códigos para tradução (pack) e (unpack):
 
@@ -77,16 +253,29 @@ ao comprimir
    ao descomprimir, o processo inverso deve ser realizado.
 */
 
+template <int EXPRESSION_LENGTH = 15,
+          int DICTIONARY_CUSTOM_LENGTH = 20,
+          int BINARY_PATH = 128,
+          class ALPHABET = CowcAlphabetFull>
 class Cowc
 {
+public:
+   typedef CowcStatistics<DICTIONARY_CUSTOM_LENGTH + ALPHABET::SIZE> Statistics; // contadores de uso para esta configuração
+
 private:
+   static_assert(EXPRESSION_LENGTH > 0 && EXPRESSION_LENGTH <= 255, "EXPRESSION_LENGTH deve estar entre 1 e 255");
+   static_assert(DICTIONARY_CUSTOM_LENGTH >= 0, "DICTIONARY_CUSTOM_LENGTH não pode ser negativo");
+   static_assert(BINARY_PATH > 0 && BINARY_PATH <= 255, "BINARY_PATH deve estar entre 1 e 255");
+
+   static const int DICTIONARY_TOTAL_LENGTH = DICTIONARY_CUSTOM_LENGTH + ALPHABET::SIZE;
+
    String keyString = ""; // guarda chave de criptografia.
 
    /* TIPO - ESTRUTURA DO NODO DA ÁRVORE DE HUFFMAN*/
    typedef struct
    {
       short unsigned int expressionLength = 0;
-      byte expression[MAX_EXPRESSION_LENGTH];
+      byte expression[EXPRESSION_LENGTH];
       unsigned long occurences = 0;
       byte *NodeLeft;  // = NULL;
       byte *NodeRigth; // = NULL;
@@ -98,16 +287,25 @@ private:
    struct cowcTableStr
    {
       huffmanNode *nodePtr;
-   } cowcTable[MAX_DICTIONARY_TOTAL_LENGTH];
+   } cowcTable[DICTIONARY_TOTAL_LENGTH];
 
    /* estrutura da tabela de códigos (após percorrer árvore) para tradução no PACK e UNPACK */
    struct cowcCodeTableStr
    {
-      byte expression[MAX_EXPRESSION_LENGTH];
+      byte expression[EXPRESSION_LENGTH];
       uint8_t expressionSize = 0;
-      byte code[1 + MAX_BINARY_PATH / 8];
+      byte code[1 + BINARY_PATH / 8];
       uint8_t codeSize = 0;
-   } cowcCodeTable[MAX_DICTIONARY_TOTAL_LENGTH];
+   } cowcCodeTable[DICTIONARY_TOTAL_LENGTH];
+
+   int codeTableLength = 0;                              // quantidade de posições ocupadas na tabela de códigos
+   int16_t symbolCode[ALPHABET::SIZE];                   // posição na tabela de códigos de cada símbolo de 1 byte, indexada pelo alfabeto (-1 se não houver)
+   int16_t expressionCode[DICTIONARY_CUSTOM_LENGTH + 1]; // posições na tabela de códigos das expressões com mais de 1 byte
+   int expressionCodeLength = 0;                         // quantidade de expressões com mais de 1 byte
+   int longestExpression = 1;                            // tamanho da maior expressão da tabela de códigos
+
+   Statistics *statistics = NULL; // contadores de uso, se houver coleta ativa
+   unsigned long keyGeneration = 0; // incrementado a cada key(), para invalidar contadores da chave anterior
 
    /* FUNÇÕES DE APOIO */
 
@@ -154,24 +352,38 @@ private:
    /* adiciona uma expressão na tabela de códigos */
    bool cowcTableAdd(byte *expression, uint8_t expressionSize, String code)
    {
-      int indice = 0;
-      for (indice = 0; indice < MAX_DICTIONARY_TOTAL_LENGTH; indice++) // acha próxima posição livre na tabela de códigos
-         if (cowcCodeTable[indice].expressionSize <= 0)
-            break;
-      if (indice >= MAX_DICTIONARY_TOTAL_LENGTH)
+      int indice = codeTableLength; // próxima posição livre na tabela de códigos
+      if (indice >= DICTIONARY_TOTAL_LENGTH)
       {
          erro(101);
          return (false); // não há como adicionar símbolo...
       }
-      for (int i = 0; i < expressionSize && i < MAX_EXPRESSION_LENGTH; i++)
-         cowcCodeTable[indice].expression[i] = expression[i]; // copia expressão recebida como parâmetro para tabela
-      cowcCodeTable[indice].expressionSize = expressionSize;  // copia tamanho da expressão
-      cowcCodeTable[indice].codeSize = code.length();         // registra tamanho do código binário gerado
-      if (code.length() > MAX_BINARY_PATH)
+      if (code.length() > BINARY_PATH)
       {
          erro(102);
          return (false);
       } // tamanho binário maior do que o que pode ser registrado
+      if (expressionSize > EXPRESSION_LENGTH)
+         expressionSize = EXPRESSION_LENGTH;
+      for (int i = 0; i < expressionSize; i++)
+         cowcCodeTable[indice].expression[i] = expression[i]; // copia expressão recebida como parâmetro para tabela
+      cowcCodeTable[indice].expressionSize = expressionSize;  // copia tamanho da expressão
+      cowcCodeTable[indice].codeSize = code.length();         // registra tamanho do código binário gerado
+      codeTableLength++;
+
+      /* registra atalhos para a busca no PACK. Em caso de expressões repetidas, vale a primeira registrada */
+      if (isKeySymbol(indice))
+      {
+         int symbolIndex = ALPHABET::index(expression[0]);
+         if (symbolCode[symbolIndex] < 0)
+            symbolCode[symbolIndex] = indice;
+      }
+      else if (expressionSize > 0 && expressionCodeLength < DICTIONARY_CUSTOM_LENGTH)
+      {
+         expressionCode[expressionCodeLength++] = indice;
+         if (expressionSize > longestExpression)
+            longestExpression = expressionSize;
+      }
 
       /* abaixo, registra o código binário em até 16 bytes - 128 bits */
       int bitNumber = 0;
@@ -203,7 +415,7 @@ private:
    }
 
    /* Cria nodo de huffman */
-   huffmanNode *createNode(int occurences /*peso*/,
+   huffmanNode *createNode(unsigned long occurences /*peso*/,
                            byte *expression /*experssao*/,
                            int expressionLength /*tamanho da expressão*/,
                            huffmanNode *left /*apontador para próximo nodo a esquerda*/,
@@ -216,40 +428,39 @@ private:
       aux->expressionLength = expressionLength;
       aux->NodeLeft = (byte *)left;
       aux->NodeRigth = (byte *)rigth;
-      for (int i = 0; i < expressionLength && i < MAX_EXPRESSION_LENGTH; i++)
+      for (int i = 0; i < expressionLength && i < EXPRESSION_LENGTH; i++)
          aux->expression[i] = expression[i];
       return (aux);
    }
 
    /* FUNÇÕES DE PREPARAÇÃO DA TABELA DE EXPRESSÕES */
-   bool insertExpressionOnTable(String linha) // interpreta uma linha da string chave e insere a expressão e peso na tabela
+   bool insertExpressionOnTable(String linha, int weigthDigits = 2) // interpreta uma linha da string chave e insere a expressão e peso na tabela. Linhas com '=' têm peso de 4 dígitos
    {
       int lineIndex;
-      byte expression[MAX_EXPRESSION_LENGTH];
-      for (lineIndex = 0; lineIndex < MAX_DICTIONARY_CUSTOM_LENGTH; lineIndex++)
+      byte expression[EXPRESSION_LENGTH];
+      for (lineIndex = 0; lineIndex < DICTIONARY_CUSTOM_LENGTH; lineIndex++)
       {
          if (cowcTable[lineIndex].nodePtr == NULL)
             break;
       }
-      if (lineIndex >= MAX_DICTIONARY_CUSTOM_LENGTH)
+      if (lineIndex >= DICTIONARY_CUSTOM_LENGTH)
       {
          erro(401);
          return (false);
       }
 
-      if (linha.length() < 2)
+      if (linha.length() < weigthDigits)
       {
          erro(402);
          return false;
       }
-      int taxa = 0;
-      taxa = hexToInt(linha[0]) * 16 + hexToInt(linha[1]);
+      unsigned long taxa = keyLineWeigth(linha, weigthDigits);
       int pos = 0;
-      for (int i = 2; i < linha.length(); i++)
+      for (int i = weigthDigits; i < linha.length(); i++)
       {
          byte b = (byte)(hexToInt(linha[i]) * 16 + hexToInt(linha[i + 1]));
          i++;
-         if (pos < MAX_EXPRESSION_LENGTH)
+         if (pos < EXPRESSION_LENGTH)
          {
             expression[pos] = b;
             pos++;
@@ -262,15 +473,15 @@ private:
    }
 
    /* INSERE CARACTERES ASCII  */
-   bool insertCharacterOnTable(char c, int weigth) // insere caractere na tabela com peso específico
+   bool insertCharacterOnTable(char c, unsigned long weigth) // insere caractere na tabela com peso específico
    {
       int lineIndex;
-      for (lineIndex = 0; lineIndex < MAX_DICTIONARY_TOTAL_LENGTH; lineIndex++)
+      for (lineIndex = 0; lineIndex < DICTIONARY_TOTAL_LENGTH; lineIndex++)
       {
          if (cowcTable[lineIndex].nodePtr == NULL)
             break;
       }
-      if (lineIndex >= MAX_DICTIONARY_TOTAL_LENGTH)
+      if (lineIndex >= DICTIONARY_TOTAL_LENGTH)
       {
          erro(501);
          return (false);
@@ -303,7 +514,7 @@ private:
       uint32_t menorOcc = 0xffffffff;
       int menorIndice = -1;
       int i = 0;
-      for (i = 0; i < MAX_DICTIONARY_TOTAL_LENGTH; i++)
+      for (i = 0; i < DICTIONARY_TOTAL_LENGTH; i++)
       {
          if (cowcTable[i].nodePtr != NULL)
          {
@@ -342,7 +553,7 @@ private:
 
          newNode = createNode(left->occurences + rigth->occurences, NULL, 0, left, rigth);
          bool fez = false;
-         for (int i = 0; i < MAX_DICTIONARY_TOTAL_LENGTH; i++)
+         for (int i = 0; i < DICTIONARY_TOTAL_LENGTH; i++)
          {
             if (cowcTable[i].nodePtr == NULL)
             {
@@ -377,32 +588,100 @@ private:
          makeCodeTable((huffmanNode *)H->NodeRigth, c + "1");
    }
 
-   void generateTable() // gera tabela de expressões, com a parte "custom" da chave, e todos os demais símbolos ASCII
+   bool nextKeyLine(int &pos, String &linha, bool &wide) // extrai da chave a próxima linha (somente dígitos hexadecimais). wide indica linha iniciada por '='. Linhas sem new-line no final são ignoradas
+   {
+      linha = "";
+      wide = (pos < keyString.length() && keyString[pos] == '=');
+      for (; pos < keyString.length(); pos++)
+      {
+         if (keyString[pos] == '\n')
+         {
+            pos++;
+            return (true);
+         }
+         if (isHex(keyString[pos]))
+            linha += keyString[pos];
+      }
+      return (false);
+   }
+
+   unsigned long keyLineWeigth(String linha, int digits) // retorna o peso dado pelos primeiros dígitos da linha da chave
+   {
+      unsigned long peso = 0;
+      for (int i = 0; i < digits; i++)
+         peso = peso * 16 + hexToInt(linha[i]);
+      return (peso);
+   }
+
+   int keyLineSymbol(String linha, bool wide) // retorna posição no alfabeto se a linha da chave ('=' com 1 byte) define o peso de um símbolo, ou -1 se não
+   {
+      if (!wide || linha.length() != 6)
+         return (-1);
+      return (ALPHABET::index((byte)(hexToInt(linha[4]) * 16 + hexToInt(linha[5]))));
+   }
+
+   void generateTable() // gera tabela de expressões, com a parte "custom" da chave, e todos os demais símbolos do alfabeto
    {
-      String line[MAX_DICTIONARY_CUSTOM_LENGTH];
-      int tableLine = 0;
-      // parte CUSTOM
-      for (int i = 0; i < MAX_DICTIONARY_CUSTOM_LENGTH; i++)
-         line[i] = "";
-      // extrai da chave, separando por linhas
-      for (int i = 0; i < keyString.length(); i++)
+      String linha;
+      bool wide;
+      int pos = 0;
+      long defaultWeigth = -1; // peso dos símbolos não listados na chave. -1 usa pesos pré-definidos
+      // parte CUSTOM: insere na tabela as expressões da chave, na ordem em que aparecem
+      while (nextKeyLine(pos, linha, wide))
+      {
+         if (!wide)
+            insertExpressionOnTable(linha);
+         else if (linha.length() == 4)
+            defaultWeigth = keyLineWeigth(linha, 4);
+         else if (keyLineSymbol(linha, wide) < 0)
+            insertExpressionOnTable(linha, 4);
+      }
+
+      // insere na tabela os símbolos do alfabeto (no alfabeto completo, 256, de 00000000 a 11111111)
+      int symbolBase = 0; // posição na tabela de expressões do primeiro símbolo do alfabeto
+      while (symbolBase < DICTIONARY_TOTAL_LENGTH && cowcTable[symbolBase].nodePtr != NULL)
+         symbolBase++;
+      for (int i = 0; i < ALPHABET::SIZE; i++)
       {
-         if (keyString[i] == '\n')
-            tableLine++;
-         if (isHex(keyString[i]))
-            line[tableLine] += keyString[i];
+         char c = (char)ALPHABET::symbol(i);
+         insertCharacterOnTable(c, defaultWeigth >= 0 ? defaultWeigth : weigthChar(c));
       }
-      // insere na tabela a linha da chave
-      for (int i = 0; i < tableLine; i++)
-         insertExpressionOnTable(line[i]);
 
-      // insere na tabela os demais símbolos ASCII (256, de 00000000 a 11111111)
-      char c = 0;
-      for (int i = 0; i < 256; i++)
+      // aplica os pesos de símbolos definidos na chave
+      pos = 0;
+      while (nextKeyLine(pos, linha, wide))
+      {
+         int symbolIndex = keyLineSymbol(linha, wide);
+         if (symbolIndex < 0 || symbolBase + symbolIndex >= DICTIONARY_TOTAL_LENGTH)
+            continue;
+         huffmanNode *N = cowcTable[symbolBase + symbolIndex].nodePtr;
+         if (N != NULL)
+            N->occurences = keyLineWeigth(linha, 4);
+      }
+   }
+
+   void freeTree(huffmanNode *H) // libera memória da árvore de huffman
+   {
+      if (H == NULL)
+         return;
+      freeTree((huffmanNode *)H->NodeLeft);
+      freeTree((huffmanNode *)H->NodeRigth);
+      free(H);
+   }
+
+   void resetTables() // limpa tabelas de expressões e de códigos, antes de gerar nova chave
+   {
+      for (int i = 0; i < DICTIONARY_TOTAL_LENGTH; i++)
       {
-         insertCharacterOnTable(c, weigthChar(c));
-         c++;
+         cowcTable[i].nodePtr = NULL;
+         cowcCodeTable[i].expressionSize = 0;
+         cowcCodeTable[i].codeSize = 0;
       }
+      for (int i = 0; i < ALPHABET::SIZE; i++)
+         symbolCode[i] = -1;
+      codeTableLength = 0;
+      expressionCodeLength = 0;
+      longestExpression = 1;
    }
 
    String printable(char c) // retorna versão "imprimível" do caractere
@@ -419,14 +698,21 @@ private:
       makeCodeTable(huffmanTreeRoot, "");
    }
 
-   int existCode(byte *expression, int size) //retorna posião de determinada expressão na tabela de códigos, se houver, ou -1 se não houver
+   int existCode(const byte *expression, int size) //retorna posião de determinada expressão na tabela de códigos, se houver, ou -1 se não houver
    {
-      for (int i = 0; i < MAX_DICTIONARY_TOTAL_LENGTH; i++)
+      if (size == 1) // símbolo individual: acesso direto pela posição no alfabeto
       {
-         if (cowcCodeTable[i].expressionSize != size)
+         int symbolIndex = ALPHABET::index(expression[0]);
+         if (symbolIndex >= 0)
+            return (symbolCode[symbolIndex]);
+      }
+      for (int i = 0; i < expressionCodeLength; i++) // demais expressões: só as vindas da chave são percorridas
+      {
+         int occ = expressionCode[i];
+         if (cowcCodeTable[occ].expressionSize != size)
             continue;
-         if (memcmp(cowcCodeTable[i].expression, expression, size) == 0)
-            return (i);
+         if (CowcMatch<EXPRESSION_LENGTH>::equal(cowcCodeTable[occ].expression, expression, size))
+            return (occ);
       }
       return (-1);
    }
@@ -517,16 +803,50 @@ private:
       return (R);
    }
 
+   /* FUNÇÕES DE APOIO ÀS ESTATÍSTICAS DE USO */
+
+   bool isKeySymbol(int occ) // retorna TRUE se a posição da tabela de códigos é um símbolo do alfabeto (e não uma expressão da chave)
+   {
+      return (cowcCodeTable[occ].expressionSize == 1 && ALPHABET::index(cowcCodeTable[occ].expression[0]) >= 0);
+   }
+
+   String byteToHex(byte b) // retorna byte em 2 dígitos hexadecimais
+   {
+      String ret = String(b >> 4, HEX);
+      ret += String(b & 0x0f, HEX);
+      return (ret);
+   }
+
+   uint16_t statisticsWeigth(int occ) // peso igual ao uso medido mais 1, para que símbolos não usados continuem com código curto o bastante
+   {
+      if (occ < 0)
+         return (1);
+      return (statistics->counter(occ) + 1); // contadores nunca passam de 0xfffe
+   }
+
 public:
    Cowc() // Cria COWC
    {
-      for (int i = 0; i < MAX_DICTIONARY_TOTAL_LENGTH; i++)
-         cowcTable[i].nodePtr = NULL;
+      resetTables();
    }
 
+   ~Cowc() // libera árvore de huffman
+   {
+      freeTree(huffmanTreeRoot);
+   }
+
+   Cowc(const Cowc &) = delete;            // cópias compartilhariam a mesma árvore de huffman
+   Cowc &operator=(const Cowc &) = delete;
+
    void key(String S) // registra a chave e cria tabela de expressões, árvore de huffman e também a tabela de códigos
    {
       keyString = S;
+      freeTree(huffmanTreeRoot);
+      huffmanTreeRoot = NULL;
+      resetTables();
+      keyGeneration++;
+      if (statistics != NULL)
+         statistics->bind(this, keyGeneration); // contadores referem-se às posições da tabela de códigos anterior
       generateTable(); // gera tabela
       build();         // constroi árvore
    }
@@ -536,33 +856,42 @@ public:
       if (huffmanTreeRoot == NULL)
          key(defaultKey); // se ainda não foi apliada uma chave, aplica a chave default;
       String binary = "";
-      String outputHex = "";
-      byte bestExpression[MAX_EXPRESSION_LENGTH];
+      const byte *text = (const byte *)S.c_str(); // posição atual no texto, evitando S.remove() a cada expressão
+      int remaining = S.length();
       int bestExpressionSize = 0;
-      while (S.length() > 0)
+      while (remaining > 0)
       {
-         for (bestExpressionSize = MAX_EXPRESSION_LENGTH; bestExpressionSize > 0; bestExpressionSize--)
+         // procura da maior para a menor expressão; não há expressões maiores do que a maior registrada
+         bestExpressionSize = longestExpression;
+         if (remaining < bestExpressionSize)
+            bestExpressionSize = remaining;
+         for (; bestExpressionSize > 0; bestExpressionSize--)
          {
-            if (S.length() < bestExpressionSize)
-               bestExpressionSize = S.length();
-            for (int pos = 0; pos < bestExpressionSize; pos++)
-               bestExpression[pos] = S[pos];
-            int occ = existCode(bestExpression, bestExpressionSize);
+            int occ = existCode(text, bestExpressionSize);
             if (occ >= 0)
             {
+               if (statistics != NULL)
+                  statistics->count(occ);
                String codigoBinario = getCode(occ);
                binary += codigoBinario;
                break;
             }
          }
          if (bestExpressionSize > 0)
-            S.remove(0, bestExpressionSize);
+         {
+            text += bestExpressionSize;
+            remaining -= bestExpressionSize;
+         }
          else
          {
             Serial.println("Problema ... expressão não codificada...");
+            if (statistics != NULL)
+               statistics->message(); // símbolos já contados pertencem a esta mensagem
             return ("");
          }
       }
+      if (statistics != NULL)
+         statistics->message();
       return (binaryTextToHexText(binary));
    }
 
@@ -660,10 +989,133 @@ public:
       return (getHuffman(binary));
    }
 
+   void collect(Statistics *S) // ativa (ou pausa, com NULL) a coleta de estatísticas de uso no PACK. Contadores de outra chave ou instância são zerados
+   {
+      statistics = S;
+      if (statistics != NULL)
+         statistics->bind(this, keyGeneration);
+   }
+
+   String statisticsKey() // gera chave com pesos iguais ao uso medido (linhas '='). Símbolos não usados recebem peso 1
+   {
+      if (statistics == NULL || huffmanTreeRoot == NULL)
+         return ("");
+      String ret = "=0001\n"; // peso padrão dos símbolos não listados
+      for (int i = 0; i < codeTableLength; i++) // expressões, na ordem da tabela de códigos
+      {
+         if (isKeySymbol(i))
+            continue;
+         uint16_t peso = statisticsWeigth(i);
+         ret += "=" + byteToHex(peso >> 8) + byteToHex(peso & 0xff);
+         for (int b = 0; b < cowcCodeTable[i].expressionSize; b++)
+            ret += byteToHex(cowcCodeTable[i].expression[b]);
+         ret += "\n";
+      }
+      for (int i = 0; i < ALPHABET::SIZE; i++) // símbolos com peso diferente do padrão
+      {
+         uint16_t peso = statisticsWeigth(symbolCode[i]);
+         if (peso <= 1)
+            continue;
+         ret += "=" + byteToHex(peso >> 8) + byteToHex(peso & 0xff);
+         ret += byteToHex(ALPHABET::symbol(i));
+         ret += "\n";
+      }
+      return (ret);
+   }
+
+   float statisticsSavedBits() // estimativa de bits economizados por mensagem com a chave de statisticsKey(), sobre o tráfego medido
+   {
+      if (statistics == NULL || huffmanTreeRoot == NULL || statistics->messages() == 0)
+         return (0);
+
+      /* folhas na mesma ordem em que key() as inseriria a partir de statisticsKey(): expressões e depois o alfabeto */
+      int leaves = 0;
+      int16_t *leafOcc = (int16_t *)malloc(sizeof(int16_t) * DICTIONARY_TOTAL_LENGTH);
+      uint32_t *weigth = (uint32_t *)malloc(sizeof(uint32_t) * 2 * DICTIONARY_TOTAL_LENGTH);
+      int16_t *parent = (int16_t *)malloc(sizeof(int16_t) * 2 * DICTIONARY_TOTAL_LENGTH);
+      int16_t *slot = (int16_t *)malloc(sizeof(int16_t) * DICTIONARY_TOTAL_LENGTH);
+      if (leafOcc == NULL || weigth == NULL || parent == NULL || slot == NULL)
+      {
+         erro(301);
+         free(leafOcc);
+         free(weigth);
+         free(parent);
+         free(slot);
+         return (0);
+      }
+      for (int i = 0; i < codeTableLength; i++)
+         if (!isKeySymbol(i))
+            leafOcc[leaves++] = i;
+      for (int i = 0; i < ALPHABET::SIZE; i++)
+         leafOcc[leaves++] = symbolCode[i];
+
+      /* reproduz buildTree() sobre os novos pesos, registrando apenas o nodo pai de cada nodo */
+      for (int i = 0; i < leaves; i++)
+      {
+         weigth[i] = statisticsWeigth(leafOcc[i]);
+         parent[i] = -1;
+         slot[i] = i;
+      }
+      int nodes = leaves;
+      while (true)
+      {
+         int menor[2] = {-1, -1};
+         for (int k = 0; k < 2; k++) // separa os dois nodos válidos de menor peso
+         {
+            uint32_t menorOcc = 0xffffffff;
+            for (int i = 0; i < leaves; i++)
+               if (slot[i] >= 0 && weigth[slot[i]] < menorOcc)
+               {
+                  menor[k] = i;
+                  menorOcc = weigth[slot[i]];
+               }
+            if (menor[k] >= 0)
+            {
+               int aux = slot[menor[k]];
+               slot[menor[k]] = -1;
+               menor[k] = aux;
+            }
+         }
+         if (menor[1] < 0)
+            break; // sobrou somente a raiz
+         weigth[nodes] = weigth[menor[0]] + weigth[menor[1]];
+         parent[nodes] = -1;
+         parent[menor[0]] = nodes;
+         parent[menor[1]] = nodes;
+         for (int i = 0; i < leaves; i++)
+            if (slot[i] < 0)
+            {
+               slot[i] = nodes;
+               break;
+            }
+         nodes++;
+      }
+
+      /* compara bits usados com os códigos atuais e com os códigos novos (profundidade de cada folha) */
+      uint32_t bitsAtuais = 0;
+      uint32_t bitsNovos = 0;
+      for (int i = 0; i < leaves; i++)
+      {
+         if (leafOcc[i] < 0)
+            continue;
+         uint32_t usos = statistics->counter(leafOcc[i]);
+         int profundidade = 0;
+         for (int n = parent[i]; n >= 0; n = parent[n])
+            profundidade++;
+         bitsAtuais += usos * cowcCodeTable[leafOcc[i]].codeSize;
+         bitsNovos += usos * profundidade;
+      }
+      free(leafOcc);
+      free(weigth);
+      free(parent);
+      free(slot);
+      return (((float)bitsAtuais - (float)bitsNovos) / statistics->messages());
+   }
+
    String printcode() // retorna tabela de códigos
    {
       String ret = "COWC Tab:\n";
-      for (int i = 0; i < MAX_DICTIONARY_TOTAL_LENGTH; i++)
+      for (int i = 0; i < DICTIONARY_TOTAL_LENGTH; i++)
       {
          if (cowcCodeTable[i].expressionSize > 0)
          {